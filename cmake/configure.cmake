@@ -36,6 +36,25 @@ if(USE_EIGEN_FOR_BLAS)
     add_definitions(-DPADDLE_USE_EIGEN_FOR_BLAS)
 endif(USE_EIGEN_FOR_BLAS)
 
+if(WITH_PGO)
+    # Profile-guided optimization is a two-pass build: the first configure
+    # instruments the binary, a representative workload is run to fill
+    # PGO_PROFILE_DIR, and reconfiguring with the profiles present rebuilds
+    # with them applied. The data-dependent branches of the operator inner
+    # loops are the main beneficiaries.
+    set(PGO_PROFILE_DIR "${CMAKE_CURRENT_BINARY_DIR}/pgo" CACHE PATH
+        "Directory holding the profiles collected by WITH_PGO builds")
+    if(EXISTS "${PGO_PROFILE_DIR}")
+        set(PGO_FLAGS "-fprofile-use=${PGO_PROFILE_DIR} -fprofile-correction")
+        message(STATUS "PGO: using profiles from ${PGO_PROFILE_DIR}")
+    else()
+        set(PGO_FLAGS "-fprofile-generate=${PGO_PROFILE_DIR}")
+        message(STATUS "PGO: instrumenting, profiles go to ${PGO_PROFILE_DIR}")
+    endif()
+    set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${PGO_FLAGS}")
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${PGO_FLAGS}")
+endif(WITH_PGO)
+
 if(NOT WITH_PROFILER)
     add_definitions(-DPADDLE_DISABLE_PROFILER)
 endif(NOT WITH_PROFILER)
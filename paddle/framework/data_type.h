@@ -27,6 +27,8 @@ inline DataType ToDataType(std::type_index type) {
     return DataType::FP64;
   } else if (typeid(int).hash_code() == type.hash_code()) {
     return DataType::INT32;
+  } else if (typeid(int16_t).hash_code() == type.hash_code()) {
+    return DataType::INT16;
   } else if (typeid(int64_t).hash_code() == type.hash_code()) {
     return DataType::INT64;
   } else {
@@ -46,6 +48,9 @@ inline void VisitDataType(DataType type, Visitor visitor) {
     case DataType::INT32:
       visitor.template operator()<int>();
       break;
+    case DataType::INT16:
+      visitor.template operator()<int16_t>();
+      break;
     case DataType::INT64:
       visitor.template operator()<int64_t>();
       break;
@@ -79,6 +79,12 @@ DDim make_ddim(const std::vector<int64_t>& dims) {
   return result;
 }
 
+DDim make_ddim(const int64_t* dims, int n) {
+  DDim result(make_dim(0));
+  make_ddim(result, dims, n);
+  return result;
+}
+
 /// @cond HIDDEN
 // XXX For some reason, putting this in an anonymous namespace causes errors
 class DynamicMutableIndexer : public boost::static_visitor<int64_t&> {
@@ -89,6 +89,13 @@ DDim make_ddim(const std::vector<int64_t>& dims);
  */
 DDim make_ddim(std::initializer_list<int64_t> dims);
 
+/**
+ * \brief Make a DDim from the first n elements of a raw array
+ *
+ * \param dims An array of ints. n must be sized between [1, 9]
+ */
+DDim make_ddim(const int64_t* dims, int n);
+
 int64_t get(const DDim& dim, int idx);
 void set(DDim& dim, int idx, int val);
 
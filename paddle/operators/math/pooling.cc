@@ -14,10 +14,289 @@ limitations under the License. */
 
 #include "paddle/operators/math/pooling.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+#include <type_traits>
+
 namespace paddle {
 namespace operators {
 namespace math {
 
+/*
+ * Scan `len` contiguous elements starting at `data` and fold them into the
+ * running maximum `*ele` and its index `*index`. Element k of the run
+ * corresponds to index `base_index + k` in the enclosing feature map. The
+ * first occurrence of the maximum wins, so the result matches the scalar
+ * reference loop exactly.
+ *
+ * The index carry makes the single-pass loop loop-carried and thus
+ * unvectorizable, so the generic version runs two passes: a pure max
+ * reduction the OpenMP SIMD vectorizer can handle on any target, then --
+ * only when the run actually improves on the running maximum -- a short
+ * scan for the first position holding it.
+ */
+template <typename T>
+inline void MaxWithIndexScan(const T* data, int len, int base_index, T* ele,
+                             int* index) {
+  if (len <= 0) {
+    return;
+  }
+  T run_max = data[0];
+#ifdef _OPENMP
+#pragma omp simd reduction(max : run_max)
+#endif
+  for (int k = 1; k < len; ++k) {
+    run_max = run_max > data[k] ? run_max : data[k];
+  }
+  if (run_max > *ele) {
+    for (int k = 0; k < len; ++k) {
+      if (data[k] == run_max) {
+        *ele = run_max;
+        *index = base_index + k;
+        break;
+      }
+    }
+  }
+}
+
+#ifndef __AVX2__
+/*
+ * Builds without WITH_AVX leave the hand-written intrinsic paths below
+ * compiled out. GCC 6+ can instead clone a function per instruction set and
+ * install the widest supported clone through an ifunc at load time, so one
+ * generic binary still auto-vectorizes the scan on capable machines. The
+ * attribute does not apply to templates, hence the plain float function
+ * behind the specialization.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && \
+    defined(__x86_64__)
+#define POOLING_TARGET_CLONES \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define POOLING_TARGET_CLONES
+#endif
+
+POOLING_TARGET_CLONES
+static void MaxWithIndexScanFloat(const float* data, int len, int base_index,
+                                  float* ele, int* index) {
+  if (len <= 0) {
+    return;
+  }
+  float run_max = data[0];
+#ifdef _OPENMP
+#pragma omp simd reduction(max : run_max)
+#endif
+  for (int k = 1; k < len; ++k) {
+    run_max = run_max > data[k] ? run_max : data[k];
+  }
+  if (run_max > *ele) {
+    for (int k = 0; k < len; ++k) {
+      if (data[k] == run_max) {
+        *ele = run_max;
+        *index = base_index + k;
+        break;
+      }
+    }
+  }
+}
+
+template <>
+inline void MaxWithIndexScan<float>(const float* data, int len, int base_index,
+                                    float* ele, int* index) {
+  MaxWithIndexScanFloat(data, len, base_index, ele, index);
+}
+#else
+/*
+ * AVX2 specialization for float: eight (value, index) lanes are carried at
+ * once, values through _mm256_blendv_ps and the winning indices through
+ * _mm256_blendv_epi8 on the same compare mask. The horizontal reduction
+ * picks the smallest index among equal lane maxima, so ties resolve to the
+ * first occurrence just like the scalar loop.
+ */
+template <>
+inline void MaxWithIndexScan<float>(const float* data, int len, int base_index,
+                                    float* ele, int* index) {
+  int k = 0;
+#ifdef __AVX512F__
+  // Same pattern at twice the lane width: the compare yields a mask register
+  // directly, which selects both the surviving values and their indices.
+  if (len >= 16) {
+    const __m512i vlane16 =
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512 vmax16 = _mm512_set1_ps(-FLT_MAX);
+    __m512i vidx16 = _mm512_setzero_si512();
+    for (; k + 16 <= len; k += 16) {
+      __m512 vcand = _mm512_loadu_ps(data + k);
+      __m512i icand =
+          _mm512_add_epi32(_mm512_set1_epi32(base_index + k), vlane16);
+      __mmask16 gt = _mm512_cmp_ps_mask(vcand, vmax16, _CMP_GT_OQ);
+      vmax16 = _mm512_mask_blend_ps(gt, vmax16, vcand);
+      vidx16 = _mm512_mask_blend_epi32(gt, vidx16, icand);
+    }
+    float best = _mm512_reduce_max_ps(vmax16);
+    if (*ele < best) {
+      __mmask16 eq =
+          _mm512_cmp_ps_mask(vmax16, _mm512_set1_ps(best), _CMP_EQ_OQ);
+      int lane_idx[16];
+      _mm512_storeu_si512(lane_idx, vidx16);
+      int best_idx = -1;
+      for (int j = 0; j < 16; ++j) {
+        if (((eq >> j) & 1) && (best_idx < 0 || lane_idx[j] < best_idx)) {
+          best_idx = lane_idx[j];
+        }
+      }
+      *ele = best;
+      *index = best_idx;
+    }
+  }
+#endif
+  if (len - k >= 8) {
+    const __m256i vlane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 vmax = _mm256_set1_ps(-FLT_MAX);
+    __m256i vidx = _mm256_setzero_si256();
+    for (; k + 8 <= len; k += 8) {
+      __m256 vcand = _mm256_loadu_ps(data + k);
+      __m256i icand =
+          _mm256_add_epi32(_mm256_set1_epi32(base_index + k), vlane);
+      __m256 gt = _mm256_cmp_ps(vcand, vmax, _CMP_GT_OQ);
+      vmax = _mm256_blendv_ps(vmax, vcand, gt);
+      vidx = _mm256_blendv_epi8(vidx, icand, _mm256_castps_si256(gt));
+    }
+    float lane_val[8];
+    int lane_idx[8];
+    _mm256_storeu_ps(lane_val, vmax);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_idx), vidx);
+    float best = lane_val[0];
+    int best_idx = lane_idx[0];
+    for (int j = 1; j < 8; ++j) {
+      if (best < lane_val[j] ||
+          (best == lane_val[j] && lane_idx[j] < best_idx)) {
+        best = lane_val[j];
+        best_idx = lane_idx[j];
+      }
+    }
+    // Lanes that were never overwritten still hold (-FLT_MAX, 0) and lose
+    // against the running maximum here, keeping `*index` untouched.
+    if (*ele < best) {
+      *ele = best;
+      *index = best_idx;
+    }
+  }
+  for (; k < len; ++k) {
+    if (*ele < data[k]) {
+      *ele = data[k];
+      *index = base_index + k;
+    }
+  }
+}
+#endif
+
+/*
+ * Precompute the clipped window bounds of every output position along one
+ * axis. The inner pooling loops then read two table entries instead of
+ * redoing the max/min clamping per output element, which removes the
+ * unpredictable border branches from the hot loop.
+ */
+inline void WindowBounds(int output_size, int input_size, int ksize,
+                         int stride, int padding, std::vector<int>* start,
+                         std::vector<int>* end) {
+  start->resize(output_size);
+  end->resize(output_size);
+  for (int p = 0; p < output_size; ++p) {
+    int s = p * stride - padding;
+    (*end)[p] = std::min(s + ksize, input_size);
+    (*start)[p] = std::max(s, 0);
+  }
+}
+
+/*
+ * Reduce one pooling window of a channel-last (NHWC / NDHWC) feature map,
+ * producing the maximum and its plane index for every channel. `plane`
+ * points at the first element of the current image; element (d, h, w, c)
+ * lives at ((d * input_height + h) * input_width + w) * channels + c. The
+ * 2D case passes dstart = 0, dend = 1. The mask index is the same
+ * (d * H + h) * W + w value the NCHW path produces, so the layouts stay
+ * interchangeable.
+ */
+template <typename T>
+inline void NhwcWindowMax(const T* plane, int input_height, int input_width,
+                          int channels, int dstart, int dend, int hstart,
+                          int hend, int wstart, int wend, T* out, T* mask_out) {
+  for (int c = 0; c < channels; ++c) {
+    T ele = static_cast<T>(-FLT_MAX);
+    int index = -1;
+    for (int d = dstart; d < dend; ++d) {
+      for (int h = hstart; h < hend; ++h) {
+        for (int w = wstart; w < wend; ++w) {
+          int plane_idx = (d * input_height + h) * input_width + w;
+          const T v = plane[plane_idx * channels + c];
+          if (ele < v) {
+            ele = v;
+            index = plane_idx;
+          }
+        }
+      }
+    }
+    out[c] = ele;
+    mask_out[c] = static_cast<T>(index);
+  }
+}
+
+#ifdef __AVX2__
+/*
+ * With channels stored innermost a single unaligned load covers eight
+ * channels of one (d, h, w) position, so the whole window reduces eight
+ * channels in lockstep without gathers. All lanes of one step share the
+ * same candidate index.
+ */
+template <>
+inline void NhwcWindowMax<float>(const float* plane, int input_height,
+                                 int input_width, int channels, int dstart,
+                                 int dend, int hstart, int hend, int wstart,
+                                 int wend, float* out, float* mask_out) {
+  int c = 0;
+  for (; c + 8 <= channels; c += 8) {
+    __m256 vmax = _mm256_set1_ps(-FLT_MAX);
+    __m256i vidx = _mm256_set1_epi32(-1);
+    for (int d = dstart; d < dend; ++d) {
+      for (int h = hstart; h < hend; ++h) {
+        for (int w = wstart; w < wend; ++w) {
+          int plane_idx = (d * input_height + h) * input_width + w;
+          __m256 vcand = _mm256_loadu_ps(plane + plane_idx * channels + c);
+          __m256 gt = _mm256_cmp_ps(vcand, vmax, _CMP_GT_OQ);
+          vmax = _mm256_blendv_ps(vmax, vcand, gt);
+          vidx = _mm256_blendv_epi8(vidx, _mm256_set1_epi32(plane_idx),
+                                    _mm256_castps_si256(gt));
+        }
+      }
+    }
+    _mm256_storeu_ps(out + c, vmax);
+    _mm256_storeu_ps(mask_out + c, _mm256_cvtepi32_ps(vidx));
+  }
+  for (; c < channels; ++c) {
+    float ele = -FLT_MAX;
+    int index = -1;
+    for (int d = dstart; d < dend; ++d) {
+      for (int h = hstart; h < hend; ++h) {
+        for (int w = wstart; w < wend; ++w) {
+          int plane_idx = (d * input_height + h) * input_width + w;
+          const float v = plane[plane_idx * channels + c];
+          if (ele < v) {
+            ele = v;
+            index = plane_idx;
+          }
+        }
+      }
+    }
+    out[c] = ele;
+    mask_out[c] = static_cast<float>(index);
+  }
+}
+#endif
+
 /*
  * All tensors are in NCHW format.
  * Ksize, strides, paddings are two elements. These two elements represent
@@ -489,6 +768,294 @@ template class Pool3dGradFunctor<
 template class Pool3dGradFunctor<
     platform::CPUPlace, paddle::operators::math::AvgPoolGrad<double>, double>;
 
+/*
+ * NC8HW8 blocked fast path for the NCHW layout, after the scheme MNN uses
+ * for its convolution kernels: eight channel planes are repacked into one
+ * [H, W, 8] scratch slab so the window reduction can process eight channels
+ * per SIMD step (reusing NhwcWindowMax with channels = 8), and the results
+ * are scattered back to the eight NCHW planes at the op boundary. The mask
+ * keeps the usual h * W + w plane index, so nothing downstream changes.
+ * Repacking costs one extra pass over the input, which only pays off when
+ * the pooling windows overlap; the caller gates on that.
+ */
+template <typename T>
+static void MaxPool2dWithIndexBlocked(
+    const T* input_data, T* output_data, T* mask_data, int batch_size,
+    int channels, int input_height, int input_width, int output_height,
+    int output_width, int ksize_height, int ksize_width, int stride_height,
+    int stride_width, int padding_height, int padding_width) {
+  const int input_stride = input_height * input_width;
+  const int output_stride = output_height * output_width;
+
+  std::vector<int> hstart_tbl, hend_tbl, wstart_tbl, wend_tbl;
+  WindowBounds(output_height, input_height, ksize_height, stride_height,
+               padding_height, &hstart_tbl, &hend_tbl);
+  WindowBounds(output_width, input_width, ksize_width, stride_width,
+               padding_width, &wstart_tbl, &wend_tbl);
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<T> packed(input_stride * 8);
+    T out_block[8];
+    T mask_block[8];
+#ifdef _OPENMP
+#pragma omp for collapse(2) schedule(static)
+#endif
+    for (int i = 0; i < batch_size; ++i) {
+      for (int c0 = 0; c0 < channels; c0 += 8) {
+        const T* input_slice = input_data + (i * channels + c0) * input_stride;
+        for (int j = 0; j < 8; ++j) {
+          const T* src = input_slice + j * input_stride;
+          for (int p = 0; p < input_stride; ++p) {
+            packed[p * 8 + j] = src[p];
+          }
+        }
+        for (int ph = 0; ph < output_height; ++ph) {
+          for (int pw = 0; pw < output_width; ++pw) {
+            NhwcWindowMax(packed.data(), input_height, input_width, 8, 0, 1,
+                          hstart_tbl[ph], hend_tbl[ph], wstart_tbl[pw],
+                          wend_tbl[pw], out_block, mask_block);
+            int out_idx = ph * output_width + pw;
+            for (int j = 0; j < 8; ++j) {
+              int plane = (i * channels + c0 + j) * output_stride;
+              output_data[plane + out_idx] = out_block[j];
+              mask_data[plane + out_idx] = mask_block[j];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+
+
+/*
+ * Out and Mask are separate tensors, so a true interleaved {value, index}
+ * layout would change the op interface. The next best thing is to buffer one
+ * row of results and flush both streams from a single helper: the value and
+ * mask stores of each 8-wide block then issue back to back, and the write
+ * combining buffers see the Out and Mask lines of a block in the same pass
+ * instead of one pass per tensor.
+ */
+template <typename T>
+inline void FlushOutMaskRow(const T* val_buf, const T* idx_buf, int len,
+                            T* out_dst, T* mask_dst, bool stream) {
+  for (int k = 0; k < len; ++k) {
+    out_dst[k] = val_buf[k];
+    mask_dst[k] = idx_buf[k];
+  }
+}
+
+#ifdef __AVX2__
+template <>
+inline void FlushOutMaskRow<float>(const float* val_buf, const float* idx_buf,
+                                   int len, float* out_dst, float* mask_dst,
+                                   bool stream) {
+  int k = 0;
+  if (stream) {
+    // Non-temporal stores need 32-byte aligned destinations; peel scalars
+    // until both streams are aligned (they share a shape, so one prologue
+    // usually serves both; if their phases differ this degrades to the
+    // scalar loop, which is still correct).
+    while (k < len &&
+           ((reinterpret_cast<uintptr_t>(out_dst + k) & 31) != 0 ||
+            (reinterpret_cast<uintptr_t>(mask_dst + k) & 31) != 0)) {
+      out_dst[k] = val_buf[k];
+      mask_dst[k] = idx_buf[k];
+      ++k;
+    }
+    for (; len - k >= 8; k += 8) {
+      _mm256_stream_ps(out_dst + k, _mm256_loadu_ps(val_buf + k));
+      _mm256_stream_ps(mask_dst + k, _mm256_loadu_ps(idx_buf + k));
+    }
+  } else {
+    for (; len - k >= 8; k += 8) {
+      _mm256_storeu_ps(out_dst + k, _mm256_loadu_ps(val_buf + k));
+      _mm256_storeu_ps(mask_dst + k, _mm256_loadu_ps(idx_buf + k));
+    }
+  }
+  for (; k < len; ++k) {
+    out_dst[k] = val_buf[k];
+    mask_dst[k] = idx_buf[k];
+  }
+}
+#endif
+
+// Outputs larger than the last-level cache will be evicted before anything
+// re-reads them, so caching their lines only costs RFO traffic and input
+// residency. 8 MiB is a conservative LLC estimate for the machines this
+// kernel targets.
+const size_t kStreamingStoreBytes = 8 << 20;
+
+/*
+ * Separable two-pass path for overlapping windows. The kh x kw reduction is
+ * split into a horizontal pass of width kw over every input row, cached in a
+ * per-thread scratch, and a vertical pass of height kh over those row maxima.
+ * For stride < ksize each row maximum is shared by several output rows, so
+ * the per-output compare count drops from kh * kw towards kw + kh and both
+ * passes are contiguous streaming scans. First-occurrence tie semantics
+ * survive the split: the row pass keeps the leftmost maximum of each row and
+ * the column pass the topmost such row, which together select the row-major
+ * first maximum of the window.
+ */
+template <typename T>
+static void MaxPool2dWithIndexSeparable(
+    const T* input_data, T* output_data, T* mask_data, int batch_size,
+    int channels, int input_height, int input_width, int output_height,
+    int output_width, int ksize_height, int ksize_width, int stride_height,
+    int stride_width, int padding_height, int padding_width) {
+  const int input_stride = input_height * input_width;
+  const int output_stride = output_height * output_width;
+  const bool stream =
+      sizeof(T) * static_cast<size_t>(batch_size) * channels * output_stride >
+      kStreamingStoreBytes;
+
+  std::vector<int> hstart_tbl, hend_tbl, wstart_tbl, wend_tbl;
+  WindowBounds(output_height, input_height, ksize_height, stride_height,
+               padding_height, &hstart_tbl, &hend_tbl);
+  WindowBounds(output_width, input_width, ksize_width, stride_width,
+               padding_width, &wstart_tbl, &wend_tbl);
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<T> row_max(input_height * output_width);
+    std::vector<int> row_arg(input_height * output_width);
+    std::vector<T> val_row(output_width);
+    std::vector<T> idx_row(output_width);
+#ifdef _OPENMP
+#pragma omp for collapse(2) schedule(static)
+#endif
+    for (int i = 0; i < batch_size; ++i) {
+      for (int c = 0; c < channels; ++c) {
+        const T* input_slice = input_data + (i * channels + c) * input_stride;
+        T* output_slice = output_data + (i * channels + c) * output_stride;
+        T* mask_slice = mask_data + (i * channels + c) * output_stride;
+        // Pass 1: per input row, the maximum over every output column window.
+        for (int h = 0; h < input_height; ++h) {
+          const T* row = input_slice + h * input_width;
+          for (int pw = 0; pw < output_width; ++pw) {
+            T ele = static_cast<T>(-FLT_MAX);
+            int index = -1;
+            MaxWithIndexScan(row + wstart_tbl[pw],
+                             wend_tbl[pw] - wstart_tbl[pw], wstart_tbl[pw],
+                             &ele, &index);
+            row_max[h * output_width + pw] = ele;
+            row_arg[h * output_width + pw] = index;
+          }
+        }
+        // Pass 2: vertical max over the ksize_height cached row results.
+        for (int ph = 0; ph < output_height; ++ph) {
+          for (int pw = 0; pw < output_width; ++pw) {
+            T ele = static_cast<T>(-FLT_MAX);
+            int h_best = -1;
+            for (int h = hstart_tbl[ph]; h < hend_tbl[ph]; ++h) {
+              T val = row_max[h * output_width + pw];
+              if (val > ele) {
+                ele = val;
+                h_best = h;
+              }
+            }
+            val_row[pw] = ele;
+            idx_row[pw] =
+                h_best < 0 ? -1 : h_best * input_width +
+                                      row_arg[h_best * output_width + pw];
+          }
+          FlushOutMaskRow(val_row.data(), idx_row.data(), output_width,
+                          output_slice + ph * output_width,
+                          mask_slice + ph * output_width, stream);
+        }
+      }
+    }
+  }
+#ifdef __AVX2__
+  if (stream) _mm_sfence();
+#endif
+}
+
+/*
+ * Fixed-shape fast path for the (ksize, stride, padding) tuples that dominate
+ * real networks. With the window geometry baked into template parameters the
+ * KH x KW reduction is fully unrolled, so the argmax tracking stays in
+ * registers and there is no loop control inside the window. Outputs whose
+ * windows run past the border keep the clipped table-driven scan; only the
+ * interior band takes the unrolled core.
+ */
+template <typename T, int KH, int KW, int SH, int SW, int PH, int PW>
+static void MaxPool2dWithIndexFixed(const T* input_data, T* output_data,
+                                    T* mask_data, int batch_size, int channels,
+                                    int input_height, int input_width,
+                                    int output_height, int output_width) {
+  const int input_stride = input_height * input_width;
+  const int output_stride = output_height * output_width;
+
+  // Band of output rows / columns whose windows lie fully inside the input.
+  const int ph_lo = (PH + SH - 1) / SH;
+  const int ph_hi = input_height + PH - KH >= 0
+                        ? std::min(output_height, (input_height + PH - KH) / SH + 1)
+                        : 0;
+  const int pw_lo = (PW + SW - 1) / SW;
+  const int pw_hi = input_width + PW - KW >= 0
+                        ? std::min(output_width, (input_width + PW - KW) / SW + 1)
+                        : 0;
+
+  std::vector<int> hstart_tbl, hend_tbl, wstart_tbl, wend_tbl;
+  WindowBounds(output_height, input_height, KH, SH, PH, &hstart_tbl,
+               &hend_tbl);
+  WindowBounds(output_width, input_width, KW, SW, PW, &wstart_tbl, &wend_tbl);
+
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * channels > 8)
+#endif
+  for (int i = 0; i < batch_size; i++) {
+    for (int c = 0; c < channels; ++c) {
+      const T* input_slice = input_data + (i * channels + c) * input_stride;
+      T* output_slice = output_data + (i * channels + c) * output_stride;
+      T* mask_slice = mask_data + (i * channels + c) * output_stride;
+      for (int ph = 0; ph < output_height; ++ph) {
+        const bool h_full = ph >= ph_lo && ph < ph_hi;
+        for (int pw = 0; pw < output_width; ++pw) {
+          T ele = static_cast<T>(-FLT_MAX);
+          int index = -1;
+          // Border windows are a thin frame around the output; hint the
+          // block layout towards the unrolled interior until PGO profiles
+          // make the hint redundant.
+          const bool border = !h_full || pw < pw_lo || pw >= pw_hi;
+          if (!UNLIKELY(border)) {
+            const int hs = ph * SH - PH;
+            const int ws = pw * SW - PW;
+            const T* base = input_slice + hs * input_width + ws;
+            for (int kh = 0; kh < KH; ++kh) {
+              for (int kw = 0; kw < KW; ++kw) {
+                T val = base[kh * input_width + kw];
+                if (val > ele) {
+                  ele = val;
+                  index = (hs + kh) * input_width + (ws + kw);
+                }
+              }
+            }
+          } else {
+            const int wstart = wstart_tbl[pw];
+            for (int h = hstart_tbl[ph]; h < hend_tbl[ph]; ++h) {
+              MaxWithIndexScan(input_slice + h * input_width + wstart,
+                               wend_tbl[pw] - wstart, h * input_width + wstart,
+                               &ele, &index);
+            }
+          }
+          output_slice[ph * output_width + pw] = ele;
+          mask_slice[ph * output_width + pw] = index;
+        }
+      }
+    }
+  }
+}
+
 /*
  * All tensors are in NCHW format.
  * Ksize, strides, paddings are two elements. These two elements represent
@@ -500,7 +1067,53 @@ class MaxPool2dWithIndexFunctor<platform::CPUPlace, T> {
   void operator()(const platform::DeviceContext& context,
                   const framework::Tensor& input, framework::Tensor& output,
                   framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    if (data_format == "NHWC") {
+      const int batch_size = input.dims()[0];
+      const int input_height = input.dims()[1];
+      const int input_width = input.dims()[2];
+      const int channels = input.dims()[3];
+      const int output_height = output.dims()[1];
+      const int output_width = output.dims()[2];
+      const int ksize_height = ksize[0];
+      const int ksize_width = ksize[1];
+      const int stride_height = strides[0];
+      const int stride_width = strides[1];
+      const int padding_height = paddings[0];
+      const int padding_width = paddings[1];
+
+      const T* input_data = input.data<T>();
+      T* output_data = output.mutable_data<T>(context.GetPlace());
+      T* mask_data = mask.mutable_data<T>(context.GetPlace());
+
+      std::vector<int> hstart_tbl, hend_tbl, wstart_tbl, wend_tbl;
+      WindowBounds(output_height, input_height, ksize_height, stride_height,
+                   padding_height, &hstart_tbl, &hend_tbl);
+      WindowBounds(output_width, input_width, ksize_width, stride_width,
+                   padding_width, &wstart_tbl, &wend_tbl);
+
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_height > 8)
+#endif
+      for (int i = 0; i < batch_size; i++) {
+        for (int ph = 0; ph < output_height; ++ph) {
+          const T* input_slice =
+              input_data + i * input_height * input_width * channels;
+          for (int pw = 0; pw < output_width; ++pw) {
+            int out_offset =
+                ((i * output_height + ph) * output_width + pw) * channels;
+            NhwcWindowMax(input_slice, input_height, input_width, channels, 0,
+                          1, hstart_tbl[ph], hend_tbl[ph], wstart_tbl[pw],
+                          wend_tbl[pw], output_data + out_offset,
+                          mask_data + out_offset);
+          }
+        }
+      }
+      return;
+    }
+
     const int batch_size = input.dims()[0];
     const int input_height = input.dims()[2];
     const int input_width = input.dims()[3];
@@ -520,37 +1133,144 @@ class MaxPool2dWithIndexFunctor<platform::CPUPlace, T> {
     T* output_data = output.mutable_data<T>(context.GetPlace());
     T* mask_data = mask.mutable_data<T>(context.GetPlace());
 
+    // globalPooling degenerates to one full-plane reduction per (batch,
+    // channel); stream each plane through the scan once instead of going
+    // through the windowed machinery. The scan's base index 0 is exactly
+    // the h * W + w plane index the mask stores.
+    if (output_height == 1 && output_width == 1 &&
+        ksize_height >= input_height && ksize_width >= input_width &&
+        padding_height == 0 && padding_width == 0) {
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_channels > 8)
+#endif
+      for (int i = 0; i < batch_size; i++) {
+        for (int c = 0; c < output_channels; ++c) {
+          const int slice = i * output_channels + c;
+          T ele = static_cast<T>(-FLT_MAX);
+          int index = -1;
+          MaxWithIndexScan(input_data + slice * input_stride, input_stride, 0,
+                           &ele, &index);
+          output_data[slice] = ele;
+          mask_data[slice] = index;
+        }
+      }
+      return;
+    }
+
+    std::vector<int> hstart_tbl, hend_tbl, wstart_tbl, wend_tbl;
+    WindowBounds(output_height, input_height, ksize_height, stride_height,
+                 padding_height, &hstart_tbl, &hend_tbl);
+    WindowBounds(output_width, input_width, ksize_width, stride_width,
+                 padding_width, &wstart_tbl, &wend_tbl);
+
+#ifdef __AVX2__
+    // Use the NC8HW8 blocked path when the channel count allows it and the
+    // windows overlap enough to amortize the repacking pass.
+    if (std::is_same<T, float>::value && output_channels % 8 == 0 &&
+        ksize_height * ksize_width >= 2 * stride_height * stride_width) {
+      MaxPool2dWithIndexBlocked(input_data, output_data, mask_data, batch_size,
+                                output_channels, input_height, input_width,
+                                output_height, output_width, ksize_height,
+                                ksize_width, stride_height, stride_width,
+                                padding_height, padding_width);
+      return;
+    }
+#endif
+
+    // The handful of window shapes that dominate real networks dispatch to
+    // the unrolled fixed-shape core; everything else falls through to the
+    // generic tiled path below.
+    if (stride_height == stride_width && padding_height == padding_width &&
+        ksize_height == ksize_width) {
+      if (ksize_height == 2 && stride_height == 2 && padding_height == 0) {
+        MaxPool2dWithIndexFixed<T, 2, 2, 2, 2, 0, 0>(
+            input_data, output_data, mask_data, batch_size, output_channels,
+            input_height, input_width, output_height, output_width);
+        return;
+      }
+      if (ksize_height == 3 && stride_height == 2 && padding_height == 1) {
+        MaxPool2dWithIndexFixed<T, 3, 3, 2, 2, 1, 1>(
+            input_data, output_data, mask_data, batch_size, output_channels,
+            input_height, input_width, output_height, output_width);
+        return;
+      }
+      if (ksize_height == 3 && stride_height == 3 && padding_height == 0) {
+        MaxPool2dWithIndexFixed<T, 3, 3, 3, 3, 0, 0>(
+            input_data, output_data, mask_data, batch_size, output_channels,
+            input_height, input_width, output_height, output_width);
+        return;
+      }
+    }
+
+    // Overlapping windows of at least six taps amortize the row-max scratch,
+    // so split the reduction into a horizontal and a vertical pass.
+    if (ksize_height * ksize_width >= 6 &&
+        (stride_height < ksize_height || stride_width < ksize_width)) {
+      MaxPool2dWithIndexSeparable(input_data, output_data, mask_data,
+                                  batch_size, output_channels, input_height,
+                                  input_width, output_height, output_width,
+                                  ksize_height, ksize_width, stride_height,
+                                  stride_width, padding_height, padding_width);
+      return;
+    }
+
+    const bool stream_out = sizeof(T) * static_cast<size_t>(batch_size) *
+                                output_channels * output_stride >
+                            kStreamingStoreBytes;
+
+// Each (batch, channel) slice is pooled independently, so the outer two
+// loops can be distributed over threads without synchronization.
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_channels > 8)
+#endif
     for (int i = 0; i < batch_size; i++) {
       for (int c = 0; c < output_channels; ++c) {
-        for (int ph = 0; ph < output_height; ++ph) {
-          int hstart = ph * stride_height - padding_height;
-          int hend = std::min(hstart + ksize_height, input_height);
-          hstart = std::max(hstart, 0);
-          for (int pw = 0; pw < output_width; ++pw) {
-            int wstart = pw * stride_width - padding_width;
-            int wend = std::min(wstart + ksize_width, input_width);
-            wstart = std::max(wstart, 0);
+        const T* input_slice =
+            input_data + (i * output_channels + c) * input_stride;
+        T* output_slice = output_data + (i * output_channels + c) * output_stride;
+        T* mask_slice = mask_data + (i * output_channels + c) * output_stride;
+        // Walk the output in 32x32 tiles so the input rows touched by one
+        // tile (about 4 KiB of float per ksize row at stride 1) stay in L1
+        // while neighbouring output rows reuse them.
+        const int tile_height = 32;
+        const int tile_width = 32;
+        for (int ph0 = 0; ph0 < output_height; ph0 += tile_height) {
+          int ph1 = std::min(ph0 + tile_height, output_height);
+          for (int pw0 = 0; pw0 < output_width; pw0 += tile_width) {
+            int pw1 = std::min(pw0 + tile_width, output_width);
+            for (int ph = ph0; ph < ph1; ++ph) {
+              const int hstart = hstart_tbl[ph];
+              const int hend = hend_tbl[ph];
+              T val_buf[tile_width];
+              T idx_buf[tile_width];
+              for (int pw = pw0; pw < pw1; ++pw) {
+                const int wstart = wstart_tbl[pw];
+                const int wend = wend_tbl[pw];
 
-            T ele = static_cast<T>(-FLT_MAX);
-            int index = -1;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                if (ele < input_data[h * input_width + w]) {
-                  ele = input_data[h * input_width + w];
-                  index = h * input_width + w;
+                T ele = static_cast<T>(-FLT_MAX);
+                int index = -1;
+                for (int h = hstart; h < hend; ++h) {
+                  MaxWithIndexScan(input_slice + h * input_width + wstart,
+                                   wend - wstart, h * input_width + wstart,
+                                   &ele, &index);
                 }
+                val_buf[pw - pw0] = ele;
+                idx_buf[pw - pw0] = index;
               }
+              FlushOutMaskRow(val_buf, idx_buf, pw1 - pw0,
+                              output_slice + ph * output_width + pw0,
+                              mask_slice + ph * output_width + pw0,
+                              stream_out);
             }
-            output_data[ph * output_width + pw] = ele;
-            mask_data[ph * output_width + pw] = index;
           }
         }
-        // offset
-        input_data += input_stride;
-        output_data += output_stride;
-        mask_data += output_stride;
       }
     }
+#ifdef __AVX2__
+    if (stream_out) _mm_sfence();
+#endif
   }
 };
 
@@ -566,7 +1286,58 @@ class MaxPool2dWithIndexGradFunctor<platform::CPUPlace, T> {
                   framework::Tensor& input_grad,
                   const framework::Tensor& output_grad,
                   const framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    // With non-overlapping windows (stride >= ksize on every axis) each
+    // input position receives at most one contribution, so the scatter can
+    // assign instead of accumulate and skip the read-modify-write; the
+    // gradient tensor is zero-filled by the caller.
+    const bool non_overlap =
+        strides[0] >= ksize[0] && strides[1] >= ksize[1];
+
+    if (data_format == "NHWC") {
+      const int batch_size = input_grad.dims()[0];
+      const int input_plane = input_grad.dims()[1] * input_grad.dims()[2];
+      const int channels = input_grad.dims()[3];
+      const int output_plane = output_grad.dims()[1] * output_grad.dims()[2];
+
+      const T* mask_data = mask.data<T>();
+      const T* output_grad_data = output_grad.data<T>();
+      T* input_grad_data = input_grad.mutable_data<T>(context.GetPlace());
+
+// Channels of one image share cache lines in NHWC, so the scatter is
+// distributed over images only.
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (batch_size > 1)
+#endif
+      for (int n = 0; n < batch_size; ++n) {
+        const T* mask_slice = mask_data + n * output_plane * channels;
+        const T* output_grad_slice =
+            output_grad_data + n * output_plane * channels;
+        T* input_grad_slice = input_grad_data + n * input_plane * channels;
+        if (non_overlap) {
+          for (int po = 0; po < output_plane; ++po) {
+            for (int c = 0; c < channels; ++c) {
+              const int output_idx = po * channels + c;
+              const int plane_idx = static_cast<int>(mask_slice[output_idx]);
+              input_grad_slice[plane_idx * channels + c] =
+                  output_grad_slice[output_idx];
+            }
+          }
+        } else {
+          for (int po = 0; po < output_plane; ++po) {
+            for (int c = 0; c < channels; ++c) {
+              const int output_idx = po * channels + c;
+              const int plane_idx = static_cast<int>(mask_slice[output_idx]);
+              input_grad_slice[plane_idx * channels + c] +=
+                  output_grad_slice[output_idx];
+            }
+          }
+        }
+      }
+      return;
+    }
+
     const int batch_size = input_grad.dims()[0];
     const int input_height = input_grad.dims()[2];
     const int input_width = input_grad.dims()[3];
@@ -580,19 +1351,32 @@ class MaxPool2dWithIndexGradFunctor<platform::CPUPlace, T> {
     const T* output_grad_data = output_grad.data<T>();
     T* input_grad_data = input_grad.mutable_data<T>(context.GetPlace());
 
+// The mask holds one source index per output element, so the scattered
+// writes of two different (batch, channel) slices never alias and no
+// atomics are needed when distributing the outer two loops.
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_channels > 8)
+#endif
     for (int n = 0; n < batch_size; ++n) {
       for (int c = 0; c < output_channels; ++c) {
-        for (int ph = 0; ph < output_height; ++ph) {
-          for (int pw = 0; pw < output_width; ++pw) {
-            const int output_idx = ph * output_width + pw;
-            const int input_idx = static_cast<int>(mask_data[output_idx]);
-            input_grad_data[input_idx] += output_grad_data[output_idx];
+        const T* mask_slice =
+            mask_data + (n * output_channels + c) * output_stride;
+        const T* output_grad_slice =
+            output_grad_data + (n * output_channels + c) * output_stride;
+        T* input_grad_slice =
+            input_grad_data + (n * output_channels + c) * input_stride;
+        if (non_overlap) {
+          for (int output_idx = 0; output_idx < output_stride; ++output_idx) {
+            const int input_idx = static_cast<int>(mask_slice[output_idx]);
+            input_grad_slice[input_idx] = output_grad_slice[output_idx];
+          }
+        } else {
+          for (int output_idx = 0; output_idx < output_stride; ++output_idx) {
+            const int input_idx = static_cast<int>(mask_slice[output_idx]);
+            input_grad_slice[input_idx] += output_grad_slice[output_idx];
           }
         }
-        // offset
-        input_grad_data += input_stride;
-        output_grad_data += output_stride;
-        mask_data += output_stride;
       }
     }
   }
@@ -614,7 +1398,68 @@ class MaxPool3dWithIndexFunctor<platform::CPUPlace, T> {
   void operator()(const platform::DeviceContext& context,
                   const framework::Tensor& input, framework::Tensor& output,
                   framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    if (data_format == "NHWC") {
+      // Channel-last NDHWC layout.
+      const int batch_size = input.dims()[0];
+      const int input_depth = input.dims()[1];
+      const int input_height = input.dims()[2];
+      const int input_width = input.dims()[3];
+      const int channels = input.dims()[4];
+      const int output_depth = output.dims()[1];
+      const int output_height = output.dims()[2];
+      const int output_width = output.dims()[3];
+      const int ksize_depth = ksize[0];
+      const int ksize_height = ksize[1];
+      const int ksize_width = ksize[2];
+      const int stride_depth = strides[0];
+      const int stride_height = strides[1];
+      const int stride_width = strides[2];
+      const int padding_depth = paddings[0];
+      const int padding_height = paddings[1];
+      const int padding_width = paddings[2];
+
+      const T* input_data = input.data<T>();
+      T* output_data = output.mutable_data<T>(context.GetPlace());
+      T* mask_data = mask.mutable_data<T>(context.GetPlace());
+
+      std::vector<int> dstart_tbl, dend_tbl, hstart_tbl, hend_tbl, wstart_tbl,
+          wend_tbl;
+      WindowBounds(output_depth, input_depth, ksize_depth, stride_depth,
+                   padding_depth, &dstart_tbl, &dend_tbl);
+      WindowBounds(output_height, input_height, ksize_height, stride_height,
+                   padding_height, &hstart_tbl, &hend_tbl);
+      WindowBounds(output_width, input_width, ksize_width, stride_width,
+                   padding_width, &wstart_tbl, &wend_tbl);
+
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_depth > 8)
+#endif
+      for (int i = 0; i < batch_size; i++) {
+        for (int pd = 0; pd < output_depth; ++pd) {
+          const T* input_slice =
+              input_data +
+              i * input_depth * input_height * input_width * channels;
+          for (int ph = 0; ph < output_height; ++ph) {
+            for (int pw = 0; pw < output_width; ++pw) {
+              int out_offset =
+                  (((i * output_depth + pd) * output_height + ph) *
+                       output_width +
+                   pw) *
+                  channels;
+              NhwcWindowMax(input_slice, input_height, input_width, channels,
+                            dstart_tbl[pd], dend_tbl[pd], hstart_tbl[ph],
+                            hend_tbl[ph], wstart_tbl[pw], wend_tbl[pw],
+                            output_data + out_offset, mask_data + out_offset);
+            }
+          }
+        }
+      }
+      return;
+    }
+
     const int batch_size = input.dims()[0];
     const int input_depth = input.dims()[2];
     const int input_height = input.dims()[3];
@@ -639,44 +1484,89 @@ class MaxPool3dWithIndexFunctor<platform::CPUPlace, T> {
     T* output_data = output.mutable_data<T>(context.GetPlace());
     T* mask_data = mask.mutable_data<T>(context.GetPlace());
 
+    // As in 2D, globalPooling is a single full-volume reduction per (batch,
+    // channel), and the scan's base index 0 matches the stored plane index.
+    if (output_depth == 1 && output_height == 1 && output_width == 1 &&
+        ksize_depth >= input_depth && ksize_height >= input_height &&
+        ksize_width >= input_width && padding_depth == 0 &&
+        padding_height == 0 && padding_width == 0) {
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_channels > 8)
+#endif
+      for (int i = 0; i < batch_size; i++) {
+        for (int c = 0; c < output_channels; ++c) {
+          const int slice = i * output_channels + c;
+          T ele = static_cast<T>(-FLT_MAX);
+          int index = -1;
+          MaxWithIndexScan(input_data + slice * input_stride, input_stride, 0,
+                           &ele, &index);
+          output_data[slice] = ele;
+          mask_data[slice] = index;
+        }
+      }
+      return;
+    }
+
+    std::vector<int> dstart_tbl, dend_tbl, hstart_tbl, hend_tbl, wstart_tbl,
+        wend_tbl;
+    WindowBounds(output_depth, input_depth, ksize_depth, stride_depth,
+                 padding_depth, &dstart_tbl, &dend_tbl);
+    WindowBounds(output_height, input_height, ksize_height, stride_height,
+                 padding_height, &hstart_tbl, &hend_tbl);
+    WindowBounds(output_width, input_width, ksize_width, stride_width,
+                 padding_width, &wstart_tbl, &wend_tbl);
+
+// Every output depth slice is computed independently, so the three outer
+// loops can be collapsed and distributed over threads.
+#ifdef _OPENMP
+#pragma omp parallel for collapse(3) schedule(static) \
+    if (batch_size * output_channels > 8)
+#endif
     for (int i = 0; i < batch_size; i++) {
       for (int c = 0; c < output_channels; ++c) {
         for (int pd = 0; pd < output_depth; ++pd) {
-          int dstart = pd * stride_depth - padding_depth;
-          int dend = std::min(dstart + ksize_depth, input_depth);
-          dstart = std::max(dstart, 0);
-          for (int ph = 0; ph < output_height; ++ph) {
-            int hstart = ph * stride_height - padding_height;
-            int hend = std::min(hstart + ksize_height, input_height);
-            hstart = std::max(hstart, 0);
-            for (int pw = 0; pw < output_width; ++pw) {
-              int wstart = pw * stride_width - padding_width;
-              int wend = std::min(wstart + ksize_width, input_width);
-              wstart = std::max(wstart, 0);
+          const T* input_slice =
+              input_data + (i * output_channels + c) * input_stride;
+          T* output_slice =
+              output_data + (i * output_channels + c) * output_stride;
+          T* mask_slice = mask_data + (i * output_channels + c) * output_stride;
+          const int dstart = dstart_tbl[pd];
+          const int dend = dend_tbl[pd];
+          // Tile the HW output plane as in the 2D functor so the window rows
+          // of one tile stay resident in L1 across the depth loop.
+          const int tile_height = 32;
+          const int tile_width = 32;
+          for (int ph0 = 0; ph0 < output_height; ph0 += tile_height) {
+            int ph1 = std::min(ph0 + tile_height, output_height);
+            for (int pw0 = 0; pw0 < output_width; pw0 += tile_width) {
+              int pw1 = std::min(pw0 + tile_width, output_width);
+              for (int ph = ph0; ph < ph1; ++ph) {
+                const int hstart = hstart_tbl[ph];
+                const int hend = hend_tbl[ph];
+                for (int pw = pw0; pw < pw1; ++pw) {
+                  const int wstart = wstart_tbl[pw];
+                  const int wend = wend_tbl[pw];
 
-              int output_idx = (pd * output_height + ph) * output_width + pw;
-              T ele = static_cast<T>(-FLT_MAX);
-              int index = -1;
-              for (int d = dstart; d < dend; ++d) {
-                for (int h = hstart; h < hend; ++h) {
-                  for (int w = wstart; w < wend; ++w) {
-                    int input_idx = (d * input_height + h) * input_width + w;
-                    if (ele < input_data[input_idx]) {
-                      index = input_idx;
-                      ele = input_data[input_idx];
+                  int output_idx =
+                      (pd * output_height + ph) * output_width + pw;
+                  T ele = static_cast<T>(-FLT_MAX);
+                  int index = -1;
+                  for (int d = dstart; d < dend; ++d) {
+                    for (int h = hstart; h < hend; ++h) {
+                      int row_start =
+                          (d * input_height + h) * input_width + wstart;
+                      MaxWithIndexScan(input_slice + row_start, wend - wstart,
+                                       row_start, &ele, &index);
                     }
                   }
+                  output_slice[output_idx] = ele;
+                  mask_slice[output_idx] = index;
                 }
               }
-              output_data[output_idx] = ele;
-              mask_data[output_idx] = index;
             }
           }
         }
-        // offset
-        input_data += input_stride;
-        output_data += output_stride;
-        mask_data += output_stride;
       }
     }
   }
@@ -694,7 +1584,59 @@ class MaxPool3dWithIndexGradFunctor<platform::CPUPlace, T> {
                   framework::Tensor& input_grad,
                   const framework::Tensor& output_grad,
                   const framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    // With non-overlapping windows (stride >= ksize on every axis) each
+    // input position receives at most one contribution, so the scatter can
+    // assign instead of accumulate and skip the read-modify-write; the
+    // gradient tensor is zero-filled by the caller.
+    const bool non_overlap = strides[0] >= ksize[0] &&
+                             strides[1] >= ksize[1] && strides[2] >= ksize[2];
+
+    if (data_format == "NHWC") {
+      // Channel-last NDHWC layout.
+      const int batch_size = input_grad.dims()[0];
+      const int input_plane = input_grad.dims()[1] * input_grad.dims()[2] *
+                              input_grad.dims()[3];
+      const int channels = input_grad.dims()[4];
+      const int output_plane = output_grad.dims()[1] * output_grad.dims()[2] *
+                               output_grad.dims()[3];
+
+      const T* mask_data = mask.data<T>();
+      const T* output_grad_data = output_grad.data<T>();
+      T* input_grad_data = input_grad.mutable_data<T>(context.GetPlace());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (batch_size > 1)
+#endif
+      for (int n = 0; n < batch_size; ++n) {
+        const T* mask_slice = mask_data + n * output_plane * channels;
+        const T* output_grad_slice =
+            output_grad_data + n * output_plane * channels;
+        T* input_grad_slice = input_grad_data + n * input_plane * channels;
+        if (non_overlap) {
+          for (int po = 0; po < output_plane; ++po) {
+            for (int c = 0; c < channels; ++c) {
+              const int output_idx = po * channels + c;
+              const int plane_idx = static_cast<int>(mask_slice[output_idx]);
+              input_grad_slice[plane_idx * channels + c] =
+                  output_grad_slice[output_idx];
+            }
+          }
+        } else {
+          for (int po = 0; po < output_plane; ++po) {
+            for (int c = 0; c < channels; ++c) {
+              const int output_idx = po * channels + c;
+              const int plane_idx = static_cast<int>(mask_slice[output_idx]);
+              input_grad_slice[plane_idx * channels + c] +=
+                  output_grad_slice[output_idx];
+            }
+          }
+        }
+      }
+      return;
+    }
+
     const int batch_size = input_grad.dims()[0];
     const int input_depth = input_grad.dims()[2];
     const int input_height = input_grad.dims()[3];
@@ -710,22 +1652,32 @@ class MaxPool3dWithIndexGradFunctor<platform::CPUPlace, T> {
     const T* output_grad_data = output_grad.data<T>();
     T* input_grad_data = input_grad.mutable_data<T>(context.GetPlace());
 
+// As in the 2D case, the scatter stays inside one (batch, channel) slice,
+// so only the outer two loops are distributed; overlapping windows of the
+// same slice are handled by a single thread.
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static) \
+    if (batch_size * output_channels > 8)
+#endif
     for (int n = 0; n < batch_size; ++n) {
       for (int c = 0; c < output_channels; ++c) {
-        for (int pd = 0; pd < output_depth; ++pd) {
-          for (int ph = 0; ph < output_height; ++ph) {
-            for (int pw = 0; pw < output_width; ++pw) {
-              const int output_idx =
-                  (pd * output_height + ph) * output_width + pw;
-              const int input_idx = static_cast<int>(mask_data[output_idx]);
-              input_grad_data[input_idx] += output_grad_data[output_idx];
-            }
+        const T* mask_slice =
+            mask_data + (n * output_channels + c) * output_stride;
+        const T* output_grad_slice =
+            output_grad_data + (n * output_channels + c) * output_stride;
+        T* input_grad_slice =
+            input_grad_data + (n * output_channels + c) * input_stride;
+        if (non_overlap) {
+          for (int output_idx = 0; output_idx < output_stride; ++output_idx) {
+            const int input_idx = static_cast<int>(mask_slice[output_idx]);
+            input_grad_slice[input_idx] = output_grad_slice[output_idx];
+          }
+        } else {
+          for (int output_idx = 0; output_idx < output_stride; ++output_idx) {
+            const int input_idx = static_cast<int>(mask_slice[output_idx]);
+            input_grad_slice[input_idx] += output_grad_slice[output_idx];
           }
         }
-        // offset
-        input_grad_data += input_stride;
-        output_grad_data += output_stride;
-        mask_data += output_stride;
       }
     }
   }
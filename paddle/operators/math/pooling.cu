@@ -656,6 +656,17 @@ template class Pool3dGradFunctor<
 template class Pool3dGradFunctor<
     platform::GPUPlace, paddle::operators::math::AvgPoolGrad<double>, double>;
 
+// Route read-only loads of the with-index kernels through the texture cache
+// on Kepler and newer; older architectures fall back to a plain load.
+template <typename T>
+__device__ __forceinline__ T LoadReadOnly(const T* ptr) {
+#if __CUDA_ARCH__ >= 350
+  return __ldg(ptr);
+#else
+  return *ptr;
+#endif
+}
+
 template <typename T>
 __global__ void KernelMaxPool2dWithIdx(
     const int nthreads, const T* input_data, T* output_data, T* mask_data,
@@ -684,9 +695,10 @@ __global__ void KernelMaxPool2dWithIdx(
     for (int h = hstart; h < hend; ++h) {
       for (int w = wstart; w < wend; ++w) {
         int input_index = h * input_width + w;
-        if (ele < input_data[input_index]) {
+        T val = LoadReadOnly(input_data + input_index);
+        if (ele < val) {
           max_index = input_index;
-          ele = input_data[input_index];
+          ele = val;
         }
       }
     }
@@ -731,8 +743,9 @@ __global__ void KernelMaxPool2DWithIdxGrad(
     output_grad += output_idx;
     for (int ph = ph_start; ph < ph_end; ++ph) {
       for (int pw = pw_start; pw < pw_end; ++pw) {
-        if (mask_data[ph * output_width + pw] == input_current_featuremap_idx)
-          gradient += output_grad[ph * output_width + pw];
+        if (LoadReadOnly(mask_data + ph * output_width + pw) ==
+            input_current_featuremap_idx)
+          gradient += LoadReadOnly(output_grad + ph * output_width + pw);
       }
     }
     input_grad[index] = gradient;
@@ -750,7 +763,11 @@ class MaxPool2dWithIndexFunctor<platform::GPUPlace, T> {
   void operator()(const platform::DeviceContext& context,
                   const framework::Tensor& input, framework::Tensor& output,
                   framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    PADDLE_ENFORCE_EQ(data_format, "NCHW",
+                      "Channel-last max pool with index is only implemented "
+                      "on CPU.");
     const int batch_size = input.dims()[0];
     const int input_channels = input.dims()[1];
     const int input_height = input.dims()[2];
@@ -797,7 +814,11 @@ class MaxPool2dWithIndexGradFunctor<platform::GPUPlace, T> {
                   framework::Tensor& input_grad,
                   const framework::Tensor& output_grad,
                   const framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    PADDLE_ENFORCE_EQ(data_format, "NCHW",
+                      "Channel-last max pool with index is only implemented "
+                      "on CPU.");
     const int batch_size = input_grad.dims()[0];
     const int input_channels = input_grad.dims()[1];
     const int input_height = input_grad.dims()[2];
@@ -872,9 +893,11 @@ __global__ void KernelMaxPool3DWithIdx(
     for (int d = dstart; d < dend; ++d) {
       for (int h = hstart; h < hend; ++h) {
         for (int w = wstart; w < wend; ++w) {
-          if (ele < input_data[(d * input_height + h) * input_width + w]) {
-            max_index = (d * input_height + h) * input_width + w;
-            ele = input_data[max_index];
+          int input_index = (d * input_height + h) * input_width + w;
+          T val = LoadReadOnly(input_data + input_index);
+          if (ele < val) {
+            max_index = input_index;
+            ele = val;
           }
         }
       }
@@ -932,10 +955,10 @@ __global__ void KernelMaxPool3DWithIdxGrad(
     for (int pd = pd_start; pd < pd_end; ++pd) {
       for (int ph = ph_start; ph < ph_end; ++ph) {
         for (int pw = pw_start; pw < pw_end; ++pw) {
-          if (mask[(pd * output_height + ph) * output_width + pw] ==
-              input_current_feature_map_idx)
-            gradient +=
-                output_grad[(pd * output_height + ph) * output_width + pw];
+          if (LoadReadOnly(mask + (pd * output_height + ph) * output_width +
+                           pw) == input_current_feature_map_idx)
+            gradient += LoadReadOnly(
+                output_grad + (pd * output_height + ph) * output_width + pw);
         }
       }
     }
@@ -954,7 +977,11 @@ class MaxPool3dWithIndexFunctor<platform::GPUPlace, T> {
   void operator()(const platform::DeviceContext& context,
                   const framework::Tensor& input, framework::Tensor& output,
                   framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    PADDLE_ENFORCE_EQ(data_format, "NCHW",
+                      "Channel-last max pool with index is only implemented "
+                      "on CPU.");
     const int batch_size = input.dims()[0];
     const int input_channels = input.dims()[1];
     const int input_depth = input.dims()[2];
@@ -1008,7 +1035,11 @@ class MaxPool3dWithIndexGradFunctor<platform::GPUPlace, T> {
                   framework::Tensor& input_grad,
                   const framework::Tensor& output_grad,
                   const framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings) {
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format) {
+    PADDLE_ENFORCE_EQ(data_format, "NCHW",
+                      "Channel-last max pool with index is only implemented "
+                      "on CPU.");
     const int batch_size = input_grad.dims()[0];
     const int input_channels = input_grad.dims()[1];
     const int input_depth = input_grad.dims()[2];
@@ -148,8 +148,10 @@ class MaxPool3dGradFunctor {
  * \brief Getting max pooling results and corresponding max index, and
  * calculating gradient.
  * In up-sampling-pooling, it is necessary to know max element index.
- * In pool2d, all tensors are in NCHW format. In pool3d, all tensors are in
- * NCDHW format.
+ * In pool2d, all tensors are in NCHW format or, when data_format is "NHWC",
+ * in channel-last NHWC format. In pool3d the corresponding formats are NCDHW
+ * and NDHWC. The mask always stores the index inside the current feature
+ * map (h * W + w), independent of the layout.
  */
 template <typename Place, typename T>
 class MaxPool2dWithIndexFunctor {
@@ -157,7 +159,8 @@ class MaxPool2dWithIndexFunctor {
   void operator()(const platform::DeviceContext& context,
                   const framework::Tensor& input, framework::Tensor& output,
                   framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings);
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format);
 };
 
 template <typename Place, typename T>
@@ -167,7 +170,8 @@ class MaxPool2dWithIndexGradFunctor {
                   framework::Tensor& input_grad,
                   const framework::Tensor& output_grad,
                   const framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings);
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format);
 };
 
 template <typename Place, typename T>
@@ -176,7 +180,8 @@ class MaxPool3dWithIndexFunctor {
   void operator()(const platform::DeviceContext& context,
                   const framework::Tensor& input, framework::Tensor& output,
                   framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings);
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format);
 };
 
 template <typename Place, typename T>
@@ -186,7 +191,8 @@ class MaxPool3dWithIndexGradFunctor {
                   framework::Tensor& input_grad,
                   const framework::Tensor& output_grad,
                   const framework::Tensor& mask, std::vector<int>& ksize,
-                  std::vector<int>& strides, std::vector<int>& paddings);
+                  std::vector<int>& strides, std::vector<int>& paddings,
+                  const std::string& data_format);
 };
 
 }  // namespace math
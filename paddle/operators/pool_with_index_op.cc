@@ -14,13 +14,16 @@ limitations under the License. */
 
 #include "paddle/operators/pool_with_index_op.h"
 
+#include <algorithm>
+#include <array>
+
 namespace paddle {
 namespace operators {
 
-inline int OutputSizeMaxPool(int input_size, int filter_size, int padding,
-                             int stride) {
-  int output_size = (input_size - filter_size + 2 * padding) / stride + 1;
-  return output_size;
+static constexpr inline int OutputSizeMaxPool(int input_size, int filter_size,
+                                              int padding,
+                                              int stride) noexcept {
+  return (input_size - filter_size + 2 * padding) / stride + 1;
 }
 
 class MaxPoolWithIndexOp : public framework::OperatorWithKernel {
@@ -37,35 +40,70 @@ class MaxPoolWithIndexOp : public framework::OperatorWithKernel {
 
     auto in_x_dims = ctx->GetInputDim("X");
 
-    std::vector<int> ksize = ctx->Attrs().Get<std::vector<int>>("ksize");
-    std::vector<int> strides = ctx->Attrs().Get<std::vector<int>>("strides");
-    std::vector<int> paddings = ctx->Attrs().Get<std::vector<int>>("paddings");
+    // AttrReader::Get returns a reference into the attribute map; keep the
+    // mutable copies that globalPooling may rewrite on the stack so shape
+    // inference does not heap-allocate on every call.
+    const std::vector<int>& attr_ksize =
+        ctx->Attrs().Get<std::vector<int>>("ksize");
+    const std::vector<int>& strides =
+        ctx->Attrs().Get<std::vector<int>>("strides");
+    const std::vector<int>& attr_paddings =
+        ctx->Attrs().Get<std::vector<int>>("paddings");
+    const std::string& data_format =
+        ctx->Attrs().Get<std::string>("data_format");
+
+    PADDLE_ENFORCE(attr_ksize.size() <= 3 && attr_paddings.size() <= 3,
+                   "Pooling size and paddings should have at most three "
+                   "elements.");
+    std::array<int, 3> ksize;
+    std::array<int, 3> paddings;
+    size_t ksize_size = attr_ksize.size();
+    std::copy(attr_ksize.begin(), attr_ksize.end(), ksize.begin());
+    std::copy(attr_paddings.begin(), attr_paddings.end(), paddings.begin());
 
     PADDLE_ENFORCE(in_x_dims.size() == 4 || in_x_dims.size() == 5,
                    "Pooling intput should be 4-D or 5-D tensor.");
+    PADDLE_ENFORCE(data_format == "NCHW" || data_format == "NHWC",
+                   "data_format should be NCHW or NHWC.");
+
+    // With channel-last layouts the spatial axes directly follow the batch
+    // axis; otherwise they follow the channel axis.
+    const bool channel_last = data_format == "NHWC";
+    const int spatial_offset = channel_last ? 1 : 2;
 
     if (ctx->Attrs().Get<bool>("globalPooling")) {
-      ksize.resize(static_cast<size_t>(in_x_dims.size()) - 2);
-      for (size_t i = 0; i < ksize.size(); ++i) {
+      ksize_size = static_cast<size_t>(in_x_dims.size()) - 2;
+      for (size_t i = 0; i < ksize_size; ++i) {
         paddings[i] = 0;
-        ksize[i] = static_cast<int>(in_x_dims[i + 2]);
+        ksize[i] = static_cast<int>(in_x_dims[i + spatial_offset]);
       }
     }
 
-    PADDLE_ENFORCE(in_x_dims.size() - ksize.size() == 2U,
+    PADDLE_ENFORCE(in_x_dims.size() - ksize_size == 2U,
                    "Input size and pooling size should be consistent.");
-    PADDLE_ENFORCE_EQ(ksize.size(), strides.size(),
+    PADDLE_ENFORCE_EQ(ksize_size, strides.size(),
                       "Strides size and pooling size should be the same.");
-    PADDLE_ENFORCE_EQ(ksize.size(), paddings.size(),
+    PADDLE_ENFORCE_EQ(ksize_size, attr_paddings.size(),
                       "Paddings size and pooling size should be the same.");
 
-    std::vector<int64_t> output_shape({in_x_dims[0], in_x_dims[1]});
-    for (size_t i = 0; i < ksize.size(); ++i) {
-      output_shape.push_back(OutputSizeMaxPool(in_x_dims[i + 2], ksize[i],
-                                               paddings[i], strides[i]));
+    // Rank is at most 5, so the output shape fits on the stack as well.
+    std::array<int64_t, 5> output_shape;
+    int output_rank = 0;
+    output_shape[output_rank++] = in_x_dims[0];
+    if (!channel_last) {
+      output_shape[output_rank++] = in_x_dims[1];
+    }
+    for (size_t i = 0; i < ksize_size; ++i) {
+      output_shape[output_rank++] = OutputSizeMaxPool(
+          in_x_dims[i + spatial_offset], ksize[i], paddings[i], strides[i]);
+    }
+    if (channel_last) {
+      output_shape[output_rank++] = in_x_dims[in_x_dims.size() - 1];
     }
-    ctx->SetOutputDim("Out", framework::make_ddim(output_shape));
-    ctx->SetOutputDim("Mask", framework::make_ddim(output_shape));
+    framework::DDim out_ddim =
+        framework::make_ddim(output_shape.data(), output_rank);
+    ctx->SetOutputDim("Out", out_ddim);
+    ctx->SetOutputDim("Mask", out_ddim);
   }
 };
 
@@ -131,6 +169,13 @@ class MaxPool2dWithIndexOpMaker : public framework::OpProtoAndCheckerMaker {
         "If globalPooling = true, paddings and will be ignored.")
         .SetDefault({0, 0});  // TODO(Chengduo): Add checker. (Currently,
     // TypedAttrChecker don't support vector type.)
+    AddAttr<std::string>(
+        "data_format",
+        "(string, default \"NCHW\") The layout of the input and output "
+        "tensors. \"NCHW\" keeps the channels in front of the spatial axes, "
+        "\"NHWC\" stores them innermost so that one SIMD load covers "
+        "several channels of a single position.")
+        .SetDefault("NCHW");
 
     AddComment(R"DOC(
 MaxPool2d Operator.
@@ -209,6 +254,12 @@ class MaxPool3dWithIndexOpMaker : public framework::OpProtoAndCheckerMaker {
         "If globalPooling = true, paddings and ksize will be ignored.")
         .SetDefault({0, 0, 0});  // TODO(Chengduo): Add checker. (Currently,
     // TypedAttrChecker don't support vector type.)
+    AddAttr<std::string>(
+        "data_format",
+        "(string, default \"NCHW\") The layout of the input and output "
+        "tensors. \"NCHW\" stands for the channel-first NCDHW layout here; "
+        "\"NHWC\" selects the channel-last NDHWC layout.")
+        .SetDefault("NCHW");
 
     AddComment(R"DOC(
 MaxPool3d Operator.
@@ -250,10 +301,12 @@ REGISTER_OP(max_pool2d_with_index, ops::MaxPoolWithIndexOp,
 
 REGISTER_OP_CPU_KERNEL(
     max_pool2d_with_index,
-    ops::MaxPoolWithIndexKernel<paddle::platform::CPUPlace, float>);
+    ops::MaxPoolWithIndexKernel<paddle::platform::CPUPlace, float>,
+    ops::MaxPoolWithIndexKernel<paddle::platform::CPUPlace, double>);
 REGISTER_OP_CPU_KERNEL(
     max_pool2d_with_index_grad,
-    ops::MaxPoolWithIndexGradKernel<paddle::platform::CPUPlace, float>)
+    ops::MaxPoolWithIndexGradKernel<paddle::platform::CPUPlace, float>,
+    ops::MaxPoolWithIndexGradKernel<paddle::platform::CPUPlace, double>)
 
 REGISTER_OP(max_pool3d_with_index, ops::MaxPoolWithIndexOp,
             ops::MaxPool3dWithIndexOpMaker, max_pool3d_with_index_grad,
@@ -261,7 +314,9 @@ REGISTER_OP(max_pool3d_with_index, ops::MaxPoolWithIndexOp,
 
 REGISTER_OP_CPU_KERNEL(
     max_pool3d_with_index,
-    ops::MaxPoolWithIndexKernel<paddle::platform::CPUPlace, float>);
+    ops::MaxPoolWithIndexKernel<paddle::platform::CPUPlace, float>,
+    ops::MaxPoolWithIndexKernel<paddle::platform::CPUPlace, double>);
 REGISTER_OP_CPU_KERNEL(
     max_pool3d_with_index_grad,
-    ops::MaxPoolWithIndexGradKernel<paddle::platform::CPUPlace, float>)
+    ops::MaxPoolWithIndexGradKernel<paddle::platform::CPUPlace, float>,
+    ops::MaxPoolWithIndexGradKernel<paddle::platform::CPUPlace, double>)
@@ -35,10 +35,14 @@ class MaxPoolWithIndexKernel : public framework::OpKernel<T> {
     std::vector<int> ksize = context.Attr<std::vector<int>>("ksize");
     std::vector<int> strides = context.Attr<std::vector<int>>("strides");
     std::vector<int> paddings = context.Attr<std::vector<int>>("paddings");
+    const std::string data_format = context.Attr<std::string>("data_format");
     if (context.Attr<bool>("globalPooling")) {
+      // The spatial axes start right after the batch axis in channel-last
+      // layouts and after the channel axis otherwise.
+      const int offset = data_format == "NHWC" ? 1 : 2;
       for (size_t i = 0; i < ksize.size(); ++i) {
         paddings[i] = 0;
-        ksize[i] = static_cast<int>(in_x->dims()[i + 2]);
+        ksize[i] = static_cast<int>(in_x->dims()[i + offset]);
       }
     }
 
@@ -47,13 +51,13 @@ class MaxPoolWithIndexKernel : public framework::OpKernel<T> {
         paddle::operators::math::MaxPool2dWithIndexFunctor<Place, T>
             pool2d_forward;
         pool2d_forward(context.device_context(), *in_x, *out, *mask, ksize,
-                       strides, paddings);
+                       strides, paddings, data_format);
       } break;
       case 3: {
         paddle::operators::math::MaxPool3dWithIndexFunctor<Place, T>
             pool3d_forward;
         pool3d_forward(context.device_context(), *in_x, *out, *mask, ksize,
-                       strides, paddings);
+                       strides, paddings, data_format);
       } break;
       default: { PADDLE_THROW("Pool op only supports 2D and 3D input."); }
     }
@@ -72,10 +76,12 @@ class MaxPoolWithIndexGradKernel : public framework::OpKernel<T> {
     std::vector<int> ksize = context.Attr<std::vector<int>>("ksize");
     std::vector<int> strides = context.Attr<std::vector<int>>("strides");
     std::vector<int> paddings = context.Attr<std::vector<int>>("paddings");
+    const std::string data_format = context.Attr<std::string>("data_format");
     if (context.Attr<bool>("globalPooling")) {
+      const int offset = data_format == "NHWC" ? 1 : 2;
       for (size_t i = 0; i < ksize.size(); ++i) {
         paddings[i] = 0;
-        ksize[i] = static_cast<int>(in_x_grad->dims()[i + 2]);
+        ksize[i] = static_cast<int>(in_x_grad->dims()[i + offset]);
       }
     }
 
@@ -90,13 +96,13 @@ class MaxPoolWithIndexGradKernel : public framework::OpKernel<T> {
           paddle::operators::math::MaxPool2dWithIndexGradFunctor<Place, T>
               pool2d_backward;
           pool2d_backward(context.device_context(), *in_x_grad, *out_grad,
-                          *mask, ksize, strides, paddings);
+                          *mask, ksize, strides, paddings, data_format);
         } break;
         case 3: {
           paddle::operators::math::MaxPool3dWithIndexGradFunctor<Place, T>
               pool3d_backward;
           pool3d_backward(context.device_context(), *in_x_grad, *out_grad,
-                          *mask, ksize, strides, paddings);
+                          *mask, ksize, strides, paddings, data_format);
         } break;
         default: { PADDLE_THROW("Pool op only supports 2D and 3D input."); }
       }
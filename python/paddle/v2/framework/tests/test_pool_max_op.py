@@ -1,5 +1,6 @@
 import unittest
 import numpy as np
+import paddle.v2.framework.core as core
 from op_test import OpTest
 
 
@@ -73,6 +74,7 @@ def max_pool2D_forward_naive(x, ksize, strides, paddings, global_pool=0):
 
 class TestMaxPoolWithIndex_Op(OpTest):
     def setUp(self):
+        self.data_format = "NCHW"
         self.init_test_case()
         if self.global_pool:
             self.paddings = [0 for _ in range(len(self.paddings))]
@@ -82,11 +84,20 @@ class TestMaxPoolWithIndex_Op(OpTest):
         output = output.astype("float32")
         mask = mask.astype("float32")
 
+        if self.data_format == "NHWC":
+            # The naive implementations work on NCHW arrays; the channel-last
+            # result is just their transpose, the mask values are unchanged.
+            axes = (0, 2, 3, 1) if input.ndim == 4 else (0, 2, 3, 4, 1)
+            input = np.transpose(input, axes).copy()
+            output = np.transpose(output, axes).copy()
+            mask = np.transpose(mask, axes).copy()
+
         self.attrs = {
             'strides': self.strides,
             'paddings': self.paddings,
             'ksize': self.ksize,
             'globalPooling': self.global_pool,
+            'data_format': self.data_format,
         }
 
         self.inputs = {'X': input}
@@ -208,5 +219,38 @@ class TestCase9(TestMaxPoolWithIndex_Op):
         self.paddings = [0, 0]
 
 
+class TestCase10(TestMaxPoolWithIndex_Op):
+    def init_test_case(self):
+        self.global_pool = False
+        self.op_type = "max_pool2d_with_index"
+        self.pool_forward_naive = max_pool2D_forward_naive
+        self.shape = [2, 16, 7, 7]
+        self.ksize = [3, 3]
+        self.strides = [1, 1]
+        self.paddings = [1, 1]
+        self.data_format = "NHWC"
+
+    # The channel-last layout is only implemented on CPU; the GPU functors
+    # reject NHWC, so skip the GPU place check_output would add.
+    def test_check_output(self):
+        self.check_output_with_place(core.CPUPlace(), atol=1e-5)
+
+
+class TestCase11(TestMaxPoolWithIndex_Op):
+    def init_test_case(self):
+        self.global_pool = False
+        self.op_type = "max_pool3d_with_index"
+        self.pool_forward_naive = max_pool3D_forward_naive
+        self.shape = [2, 16, 5, 5, 5]
+        self.ksize = [3, 3, 3]
+        self.strides = [2, 2, 2]
+        self.paddings = [0, 0, 0]
+        self.data_format = "NHWC"
+
+    # See TestCase10: the channel-last layout is CPU only.
+    def test_check_output(self):
+        self.check_output_with_place(core.CPUPlace(), atol=1e-5)
+
+
 if __name__ == '__main__':
     unittest.main()